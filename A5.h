@@ -0,0 +1,91 @@
+/*
+ * Interface to the GSM A5/1 and A5/2 implementation in A51_Original.c,
+ * for programs that link against it as a library instead of running it.
+ *
+ * Copyright (C) 1998-1999: Marc Briceno, Ian Goldberg, and David Wagner
+ * See A51_Original.c for the license and distribution terms.
+ *
+ * Which of A5/1 or A5/2 you get is decided when the library is built:
+ * A5/2 if it was compiled with A5_2 defined, A5/1 otherwise.
+ *
+ * Keys are 8 bytes, LSB of the first byte loaded first.  Frame numbers
+ * are 22 bits.  Bursts are 114 bits, packed MSB first into 15-byte
+ * buffers, unless stated otherwise.
+ *
+ * All the state of a session lives in an a5_ctx from a5_new().  Separate
+ * contexts may be used from separate threads at the same time; a single
+ * context may only be used by one thread at a time.  Only a5_new()
+ * allocates memory; a5_savekeystream() and a5_loadkeystream() also open
+ * a file, which allocates inside the C library.  Nothing else does.
+ * Input buffers are const; nothing in the interface passes stdio
+ * streams, so the library can use a different C runtime from its
+ * caller.
+ */
+
+#ifndef A5_H
+#define A5_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct a5_ctx a5_ctx;
+
+/* Allocate a context, or return NULL if out of memory; and free one. */
+a5_ctx *a5_new(void);
+void a5_free(a5_ctx *c);
+
+/* Set up the cipher for one frame of one key. */
+void a5_keysetup(a5_ctx *c, const unsigned char key[8],
+                 unsigned long frame);
+
+/* Choose how a5_keysetup() loads the key and frame number: by combining
+ * precomputed shares (on != 0, the default), or by clocking them in one
+ * bit at a time as the reference implementation does (on == 0).  The
+ * keystream is the same either way. */
+void a5_setlinear(a5_ctx *c, int on);
+
+/* Generate the A->B and B->A keystream of the frame set up last. */
+void a5_run(a5_ctx *c, unsigned char AtoBkeystream[],
+            unsigned char BtoAkeystream[]);
+
+/* Encrypt or decrypt, in place, the two bursts of the frame set up last.
+ * a5_encryptbits() takes one bit per byte and a5_encryptsoft() takes
+ * signed soft bits, 114 of them per direction.  A positive soft bit is
+ * a 0 and a negative one a 1, with the magnitude as the confidence and
+ * 0 as an erasure; a keystream 1 negates the value (-128 becomes 127). */
+void a5_encrypt(a5_ctx *c, unsigned char AtoB[], unsigned char BtoA[]);
+void a5_encryptbits(a5_ctx *c, unsigned char AtoB[], unsigned char BtoA[]);
+void a5_encryptsoft(a5_ctx *c, signed char AtoB[], signed char BtoA[]);
+
+/* The same for n frames at once: frame j is frame number frames[j]
+ * under key keys[j].  a5_runbatch() writes its keystream into AtoB[j]
+ * and BtoA[j]; a5_encryptbatch() encrypts or decrypts the bursts there. */
+void a5_runbatch(a5_ctx *c, const unsigned char keys[][8],
+                 const unsigned long frames[], int n,
+                 unsigned char AtoB[][15], unsigned char BtoA[][15]);
+void a5_encryptbatch(a5_ctx *c, const unsigned char keys[][8],
+                     const unsigned long frames[], int n,
+                     unsigned char AtoB[][15], unsigned char BtoA[][15]);
+
+/* How many key setups on this context so far reused the work done for
+ * the previous key (hits) and how many did not (misses). */
+void a5_cachestats(a5_ctx *c, unsigned long *hits, unsigned long *misses);
+
+/* Write the keystream of frames first..last (at most 0x3FFFFF) under
+ * one key to a file, and read back the keystream of one frame from such
+ * a file.  The file records its key and frame range, and reading it
+ * back under another key fails.  Both return 0 on success and -1 on
+ * failure; a failed write leaves no file behind. */
+int a5_savekeystream(a5_ctx *c, const unsigned char key[8],
+                     unsigned long first, unsigned long last,
+                     const char *filename);
+int a5_loadkeystream(const char *filename, const unsigned char key[8],
+                     unsigned long frame,
+                     unsigned char AtoB[], unsigned char BtoA[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* A5_H */
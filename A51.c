@@ -262,9 +262,10 @@ void keysetup(word key, word frame) {
         /* Now the key is properly set up. */
 }
 
+/* Print a register of size bits (at most 32), MSB first. */
 void printR(word R, int size, char* str) {
     int i;
-    bit* bitkeyarray = malloc(size*sizeof(bit));
+    bit bitkeyarray[32];
 
     printf("%s", str);
     for (i = 0; i < size; i++){
@@ -280,7 +281,6 @@ void printR(word R, int size, char* str) {
     }
 
     printf("\n");
-    free(bitkeyarray);
 }
 
 /* Generate output.  We generate 228 bits of
@@ -0,0 +1,569 @@
+/*
+ * Command line driver for the GSM A5/1 and A5/2 implementation in
+ * A51_Original.c: the self-check against the test vectors, keystream
+ * generation and decryption of frames read from standard input, and a
+ * benchmark.  Everything here goes through the interface in A5.h.
+ *
+ * Copyright (C) 1998-1999: Marc Briceno, Ian Goldberg, and David Wagner
+ * See A51_Original.c for the license and distribution terms.
+ *
+ * Build it together with A51_Original.c, with A5_2 defined for both or
+ * for neither.
+ */
+
+
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "A5.h"
+
+
+typedef unsigned char byte;
+typedef unsigned long word;
+typedef word bit;
+
+
+/* Test the code by comparing it against
+ * a known-good test vector. */
+void test() {
+#ifndef A5_2
+        byte key[8] = {0x12, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF};
+        word frame = 0x134;
+        byte goodAtoB[15] = { 0x53, 0x4E, 0xAA, 0x58, 0x2F, 0xE8, 0x15,
+                              0x1A, 0xB6, 0xE1, 0x85, 0x5A, 0x72, 0x8C, 0x00 };
+        byte goodBtoA[15] = { 0x24, 0xFD, 0x35, 0xA3, 0x5D, 0x5F, 0xB6,
+                              0x52, 0x6D, 0x32, 0xF9, 0x06, 0xDF, 0x1A, 0xC0 };
+#else /* A5_2 */
+        byte key[8] = {0x00, 0xfc, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+        word frame = 0x21;
+        byte goodAtoB[15] = { 0xf4, 0x51, 0x2c, 0xac, 0x13, 0x59, 0x37,
+                              0x64, 0x46, 0x0b, 0x72, 0x2d, 0xad, 0xd5, 0x00 };
+        byte goodBtoA[15] = { 0x48, 0x00, 0xd4, 0x32, 0x8e, 0x16, 0xa1,
+                              0x4d, 0xcd, 0x7b, 0x97, 0x22, 0x26, 0x51, 0x00 };
+#endif /* A5_2 */
+        /* Two more frames, to exercise the reuse of the key's and the
+         * frame number's share in a5_keysetup(): the same key at another
+         * frame number, then another key at that frame number.  The
+         * expected output comes from the unoptimized key setup. */
+        byte key2[8] = {0xEF, 0xCD, 0xAB, 0x89, 0x67, 0x45, 0x23, 0x12};
+#ifndef A5_2
+        word frame2 = 0x135;
+        byte good2[2][2][15] = {
+                { { 0x2F, 0x0C, 0xB6, 0x40, 0x24, 0xA5, 0xA8, 0x07,
+                    0xFD, 0x2A, 0x15, 0x0A, 0x14, 0x69, 0x00 },
+                  { 0xC9, 0x8F, 0x53, 0x82, 0x53, 0x87, 0x9C, 0x69,
+                    0x9D, 0x7B, 0x52, 0x4B, 0x80, 0x77, 0x00 } },
+                { { 0x46, 0x3C, 0x42, 0x9D, 0x87, 0xDB, 0xF1, 0x5B,
+                    0xBF, 0x36, 0x3B, 0xBC, 0x5D, 0xB7, 0x40 },
+                  { 0xBA, 0x3C, 0x05, 0x30, 0xA6, 0xF8, 0xE4, 0x1E,
+                    0xF4, 0x3E, 0x1C, 0x75, 0x75, 0x15, 0x80 } } };
+#else /* A5_2 */
+        word frame2 = 0x22;
+        byte good2[2][2][15] = {
+                { { 0xa9, 0x8d, 0x45, 0xa9, 0xe6, 0x3d, 0x7f, 0xdd,
+                    0xbf, 0xc0, 0x9f, 0x79, 0x30, 0x0e, 0xc0 },
+                  { 0xba, 0x65, 0xef, 0x77, 0x66, 0xf0, 0x04, 0xd0,
+                    0xbd, 0x31, 0x84, 0x11, 0x24, 0xbd, 0xc0 } },
+                { { 0xad, 0xe2, 0x3c, 0xb6, 0xe1, 0xd4, 0xc4, 0x43,
+                    0x5a, 0x07, 0x83, 0x37, 0xe4, 0x72, 0x80 },
+                  { 0xd5, 0x63, 0x18, 0x69, 0x3d, 0x47, 0x5f, 0x00,
+                    0x9d, 0x30, 0xfb, 0x4f, 0x97, 0x7a, 0x00 } } };
+#endif /* A5_2 */
+        byte AtoB[15], BtoA[15], enc[2][15], cross[2][15], bits[2][114];
+        byte rkey[8];
+        word rframe;
+        signed char soft[2][114];
+        signed char softin[3] = { 100, 0, -128 }, softout[3] = { -100, 0, 127 };
+        byte *burst[2] = { goodAtoB, goodBtoA };
+        int i, j, k, failed=0;
+        a5_ctx *c = a5_new(), *r = a5_new();
+
+
+        if (c == NULL || r == NULL) {
+                printf("Out of memory.\n");
+                a5_free(c);
+                a5_free(r);
+                return;
+        }
+
+        a5_keysetup(c, key, frame);
+        a5_run(c, AtoB, BtoA);
+
+
+        /* Compare against the test vector. */
+        for (i=0; i<15; i++)
+                if (AtoB[i] != goodAtoB[i])
+                        failed = 1;
+        for (i=0; i<15; i++)
+                if (BtoA[i] != goodBtoA[i])
+                        failed = 1;
+
+
+        /* The encryption functions must XOR in the same keystream:
+         * encrypting zeros gives the keystream itself, and encrypting
+         * soft bits negates exactly those under a keystream 1, which
+         * leaves erasures (0) alone and saturates -128 to 127.
+         * These and the checks below use their own buffers, so that
+         * AtoB and BtoA still hold the output printed further down. */
+        memset(enc, 0, sizeof(enc));
+        a5_keysetup(c, key, frame);
+        a5_encrypt(c, enc[0], enc[1]);
+        if (memcmp(enc[0], goodAtoB, 15) != 0 || memcmp(enc[1], goodBtoA, 15) != 0)
+                failed = 1;
+
+        memset(bits, 0, sizeof(bits));
+        a5_keysetup(c, key, frame);
+        a5_encryptbits(c, bits[0], bits[1]);
+        for (j=0; j<2; j++)
+                for (i=0; i<114; i++)
+                        if (bits[j][i] != ((burst[j][i/8] >> (7-(i&7))) & 1))
+                                failed = 1;
+        for (k=0; k<3; k++) {
+                memset(soft, softin[k], sizeof(soft));
+                a5_keysetup(c, key, frame);
+                a5_encryptsoft(c, soft[0], soft[1]);
+                for (j=0; j<2; j++)
+                        for (i=0; i<114; i++) {
+                                bit b = (burst[j][i/8] >> (7-(i&7))) & 1;
+                                if (soft[j][i] != (b ? softout[k] : softin[k]))
+                                        failed = 1;
+                        }
+        }
+
+
+        /* Same key, new frame number; then new key, same frame number. */
+        for (j=0; j<2; j++) {
+                a5_keysetup(c, j == 0 ? key : key2, frame2);
+                a5_run(c, enc[0], enc[1]);
+                if (memcmp(enc[0], good2[j][0], 15) != 0
+                    || memcmp(enc[1], good2[j][1], 15) != 0)
+                        failed = 1;
+        }
+
+
+        /* The clocked key setup must agree with the linear one.  Try
+         * both on the test vector's frame and then on some random ones,
+         * where the key and the frame number each repeat now and then
+         * so that the work kept from the last key setup gets reused.
+         * rand() is not seeded, so the frames are the same each run. */
+        a5_setlinear(r, 0);
+        memcpy(rkey, key, 8);
+        rframe = frame;
+        for (k=0; k<32; k++) {
+                if (k > 0 && rand() % 3 != 0)
+                        for (i=0; i<8; i++)
+                                rkey[i] = rand() & 0xFF;
+                if (k > 0 && rand() % 3 != 0)
+                        rframe = (((word)rand() << 15) ^ rand()) & 0x3FFFFF;
+                a5_keysetup(c, rkey, rframe);
+                a5_run(c, enc[0], enc[1]);
+                a5_keysetup(r, rkey, rframe);
+                a5_run(r, cross[0], cross[1]);
+                if (memcmp(enc, cross, sizeof(enc)) != 0)
+                        failed = 1;
+        }
+        a5_free(c);
+        a5_free(r);
+
+
+        /* Print some debugging output. */
+        printf("A5 Original\n");
+        printf("key: 0x");
+        for (i=0; i<8; i++)
+                printf("%02X", key[i]);
+        printf("\n");
+        printf("frame number: 0x%06X\n", (unsigned int)frame);
+        printf("known good output:\n");
+        printf(" A->B: 0x");
+        for (i=0; i<15; i++)
+                printf("%02X", goodAtoB[i]);
+        printf("  B->A: 0x");
+        for (i=0; i<15; i++)
+                printf("%02X", goodBtoA[i]);
+        printf("\n");
+        printf("observed output:\n");
+        printf(" A->B: 0x");
+        for (i=0; i<15; i++)
+                printf("%02X", AtoB[i]);
+        printf("  B->A: 0x");
+        for (i=0; i<15; i++)
+                printf("%02X", BtoA[i]);
+        printf("\n");
+
+
+        if (!failed) {
+                printf("Self-check succeeded: everything looks ok.\n");
+                exit(0);
+        } else {
+                /* Problems!  The test vectors didn't compare*/
+                printf("\nI don't know why this broke; contact the authors.\n");
+        }
+}
+
+
+/* The value of a hex digit. */
+int hexvalue(char c) {
+        if (c >= '0' && c <= '9')
+                return c - '0';
+        if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+        return c - 'A' + 10;
+}
+
+
+/* Skip blanks, and an optional 0x prefix if prefix is set. */
+char *skipblanks(char *s, int prefix) {
+        while (*s == ' ' || *s == '\t')
+                s++;
+        if (prefix && s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+                s += 2;
+        return s;
+}
+
+
+/* True if s is at the end of a field: a blank or the end of the line. */
+int endoffield(char *s) {
+        return *s == ' ' || *s == '\t' || *s == '\r' || *s == '\n' || *s == '\0';
+}
+
+
+/* Read n bytes written as exactly 2n hex digits, first byte first,
+ * which is how test() prints keys and keystream.  Returns a pointer
+ * just past the digits, or NULL if the field is not exactly that. */
+char *readhex(char *s, byte buf[], int n) {
+        int i;
+
+        s = skipblanks(s, 1);
+        for (i=0; i<n; i++) {
+                if (!isxdigit((unsigned char)s[0]) || !isxdigit((unsigned char)s[1]))
+                        return NULL;
+                buf[i] = (hexvalue(s[0]) << 4) | hexvalue(s[1]);
+                s += 2;
+        }
+        return endoffield(s) ? s : NULL;
+}
+
+
+/* Read a frame number in hex, which must fit in 22 bits.  Returns a
+ * pointer just past it, or NULL if it is missing or out of range. */
+char *readframe(char *s, word *frame) {
+        int digits = 0;
+
+        s = skipblanks(s, 1);
+        *frame = 0;
+        while (isxdigit((unsigned char)*s)) {
+                *frame = (*frame << 4) | hexvalue(*s++);
+                digits++;
+                if (*frame > 0x3FFFFF)
+                        return NULL;
+        }
+        return digits > 0 && endoffield(s) ? s : NULL;
+}
+
+
+/* Print n bytes as 2n hex digits, first byte first. */
+void writehex(byte buf[], int n) {
+        static const char digits[] = "0123456789ABCDEF";
+        int i;
+
+        for (i=0; i<n; i++) {
+                putchar(digits[buf[i] >> 4]);
+                putchar(digits[buf[i] & 0x0F]);
+        }
+}
+
+
+/* Lines are read in blocks of up to BLOCK lines per thread; each
+ * thread works through a contiguous share of the block, so that runs
+ * of lines under one key stay on one context, and the results are
+ * written in input order once they are all done. */
+#define BLOCK    4096
+#define MINSHARE 256    /* fewer lines than this are not worth a thread */
+#define MAXTHREADS 64
+
+
+/* One line of input, and then its result. */
+struct job {
+        byte key[8];
+        word frame;
+        byte AtoB[15], BtoA[15];
+};
+
+
+/* A share of a block, with the context of the thread that runs it. */
+struct worker {
+        pthread_t thread;
+        a5_ctx *c;
+        struct job *jobs;
+        int n, decrypt;
+};
+
+
+/* Parse one line of the form "key frame [AtoB BtoA]" into a job.
+ * Returns 0, or -1 if the line is malformed. */
+int readjob(char *line, int decrypt, struct job *j) {
+        char *s;
+
+        if ((s = readhex(line, j->key, 8)) == NULL
+            || (s = readframe(s, &j->frame)) == NULL)
+                return -1;
+        if (decrypt) {
+                if ((s = readhex(s, j->AtoB, 15)) == NULL
+                    || (s = readhex(s, j->BtoA, 15)) == NULL)
+                        return -1;
+        }
+        /* Nothing may follow the last field. */
+        return endoffield(skipblanks(s, 0)) ? 0 : -1;
+}
+
+
+/* Run the jobs of one worker on its own context. */
+void *work(void *arg) {
+        struct worker *w = arg;
+        int i;
+
+        for (i=0; i<w->n; i++) {
+                a5_keysetup(w->c, w->jobs[i].key, w->jobs[i].frame);
+                if (w->decrypt)
+                        a5_encrypt(w->c, w->jobs[i].AtoB, w->jobs[i].BtoA);
+                else
+                        a5_run(w->c, w->jobs[i].AtoB, w->jobs[i].BtoA);
+        }
+        return NULL;
+}
+
+
+/* Read lines of the form "key frame [AtoB BtoA]" from standard input,
+ * with the key and bursts in hex as printed by test() and the frame
+ * number in hex, at most 0x3FFFFF.  For each line, print the keystream
+ * of that frame (gen) or the bursts decrypted with it (decrypt), as
+ * "AtoB BtoA" in hex, or as the raw 30 bytes if binary is set.  The
+ * work is spread over nthreads threads, one context each, and the
+ * output comes out in the order of the input.
+ * Returns the number of lines that could not be read, or -1 if out of
+ * memory. */
+int stream(a5_ctx *c[], int nthreads, int decrypt, int binary) {
+        char line[256];
+        struct job *jobs;
+        struct worker w[MAXTHREADS];
+        int ch, i, n, share, used, bad = 0, done = 0;
+
+        if ((jobs = malloc((size_t)nthreads * BLOCK * sizeof(struct job))) == NULL)
+                return -1;
+        while (!done && !ferror(stdout)) {
+                /* Fill a block. */
+                n = 0;
+                while (n < nthreads * BLOCK) {
+                        if (fgets(line, sizeof(line), stdin) == NULL) {
+                                done = 1;
+                                break;
+                        }
+                        /* A line too long for the buffer is malformed
+                         * anyway; throw away the rest of it. */
+                        if (strchr(line, '\n') == NULL && !feof(stdin)) {
+                                while ((ch = getchar()) != EOF && ch != '\n')
+                                        ;
+                                bad++;
+                                continue;
+                        }
+                        if (readjob(line, decrypt, &jobs[n]) != 0) {
+                                bad++;
+                                continue;
+                        }
+                        n++;
+                }
+
+                /* Share it out; the calling thread takes the first
+                 * share, and also any share whose thread would not
+                 * start. */
+                used = (n + MINSHARE - 1) / MINSHARE;
+                if (used > nthreads)
+                        used = nthreads;
+                share = used > 0 ? (n + used - 1) / used : 0;
+                for (i=0; i<used; i++) {
+                        w[i].c = c[i];
+                        w[i].jobs = jobs + i*share;
+                        w[i].n = n - i*share < share ? n - i*share : share;
+                        w[i].decrypt = decrypt;
+                        if (i > 0 && pthread_create(&w[i].thread, NULL, work, &w[i]) != 0)
+                                w[i].c = NULL;
+                }
+                if (used > 0)
+                        work(&w[0]);
+                for (i=1; i<used; i++) {
+                        if (w[i].c == NULL) {
+                                w[i].c = c[0];
+                                work(&w[i]);
+                        } else {
+                                pthread_join(w[i].thread, NULL);
+                        }
+                }
+
+                /* Write it out in input order. */
+                for (i=0; i<n; i++) {
+                        if (binary) {
+                                fwrite(jobs[i].AtoB, 1, 15, stdout);
+                                fwrite(jobs[i].BtoA, 1, 15, stdout);
+                        } else {
+                                writehex(jobs[i].AtoB, 15);
+                                putchar(' ');
+                                writehex(jobs[i].BtoA, 15);
+                                putchar('\n');
+                        }
+                }
+        }
+        free(jobs);
+        if (bad)
+                fprintf(stderr, "%d malformed input lines skipped\n", bad);
+        return bad;
+}
+
+
+/* Time key setup plus keystream generation for n frames, first with
+ * one key and n frame numbers, as when decrypting a call, then with n
+ * keys and one frame number, as when building tables, and print the
+ * rates.  Both are timed with the linear key setup and again with the
+ * clocked one. */
+void bench(a5_ctx *c, long n) {
+        static const byte key0[8] = {0x12, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF};
+        byte key[8], AtoB[15], BtoA[15];
+        struct timeval start, end;
+        unsigned long hits0, misses0, hits, misses;
+        double seconds;
+        long i;
+        int linear, pass;
+
+        for (linear=1; linear>=0; linear--) {
+                a5_setlinear(c, linear);
+                for (pass=0; pass<2; pass++) {
+                        memcpy(key, key0, 8);
+                        a5_cachestats(c, &hits0, &misses0);
+                        gettimeofday(&start, NULL);
+                        for (i=0; i<n; i++) {
+                                if (pass == 0) {
+                                        a5_keysetup(c, key, i & 0x3FFFFF);
+                                } else {
+                                        key[0] = i; key[1] = i >> 8; key[2] = i >> 16;
+                                        a5_keysetup(c, key, 0x134);
+                                }
+                                a5_run(c, AtoB, BtoA);
+                        }
+                        gettimeofday(&end, NULL);
+                        seconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+                        a5_cachestats(c, &hits, &misses);
+                        hits -= hits0;
+                        misses -= misses0;
+                        printf("%s, %s: %ld frames in %.3f s: %.0f frames/s, "
+                               "key reused in %.1f%% of key setups\n",
+                               linear ? "linear" : "clocked",
+                               pass == 0 ? "one key, many frames" : "many keys, one frame",
+                               n, seconds, seconds > 0 ? n / seconds : 0.0,
+                               hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0);
+                }
+        }
+        a5_setlinear(c, 1);
+}
+
+
+void usage(char *name) {
+        fprintf(stderr,
+                "usage: %s [verify]\n"
+                "       %s gen [-b]      < \"key frame\" lines\n"
+                "       %s decrypt [-b]  < \"key frame AtoB BtoA\" lines\n"
+                "       %s bench [frames]\n"
+                "Keys, frame numbers and bursts are in hex; -b writes the\n"
+                "30 bytes of each frame in binary instead of a hex line.\n"
+                "gen and decrypt use every online processor.\n",
+                name, name, name, name);
+}
+
+
+/* Read the number of frames for bench: a positive decimal number and
+ * nothing else.  Returns 0, or -1 if arg is not that. */
+int readcount(char *arg, long *n) {
+        char *end;
+
+        if (!isdigit((unsigned char)arg[0]))
+                return -1;
+        errno = 0;
+        *n = strtol(arg, &end, 10);
+        if (*end != '\0' || errno == ERANGE || *n <= 0)
+                return -1;
+        return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+        static char outbuf[1 << 20];
+        int binary = 0, status = 1, nthreads = 1, i;
+        long n = 1000000;
+        a5_ctx *c[MAXTHREADS];
+
+        if (argc < 2 || strcmp(argv[1], "verify") == 0) {
+                if (argc > 2) {
+                        usage(argv[0]);
+                        return 1;
+                }
+                test();
+                return 1; /* test() only returns if the self-check failed */
+        }
+        /* gen and decrypt take only -b, bench only a frame count. */
+        if (strcmp(argv[1], "gen") == 0 || strcmp(argv[1], "decrypt") == 0) {
+                if (argc > 3 || (argc == 3 && strcmp(argv[2], "-b") != 0)) {
+                        usage(argv[0]);
+                        return 1;
+                }
+                binary = argc == 3;
+        } else if (strcmp(argv[1], "bench") == 0) {
+                if (argc > 3 || (argc == 3 && readcount(argv[2], &n) != 0)) {
+                        usage(argv[0]);
+                        return 1;
+                }
+        } else {
+                usage(argv[0]);
+                return 1;
+        }
+        /* gen and decrypt use one thread, and one context, per online
+         * processor; bench measures a single one. */
+        if (strcmp(argv[1], "bench") != 0) {
+                nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+                if (nthreads < 1)
+                        nthreads = 1;
+                if (nthreads > MAXTHREADS)
+                        nthreads = MAXTHREADS;
+        }
+        for (i=0; i<nthreads; i++) {
+                if ((c[i] = a5_new()) == NULL) {
+                        fprintf(stderr, "out of memory\n");
+                        while (i-- > 0)
+                                a5_free(c[i]);
+                        return 1;
+                }
+        }
+
+        /* Output is written in large blocks, not line by line. */
+        setvbuf(stdout, outbuf, _IOFBF, sizeof(outbuf));
+        if (strcmp(argv[1], "bench") == 0) {
+                bench(c[0], n);
+                status = 0;
+        } else {
+                status = stream(c, nthreads, strcmp(argv[1], "decrypt") == 0, binary);
+                if (status < 0)
+                        fprintf(stderr, "out of memory\n");
+                status = status ? 1 : 0;
+        }
+        for (i=0; i<nthreads; i++)
+                a5_free(c[i]);
+        /* Output that could not be written is a failure too, e.g. on a
+         * full disk; the block buffer may still hold the last of it. */
+        if (fflush(stdout) != 0 || ferror(stdout)) {
+                fprintf(stderr, "error writing output\n");
+                status = 1;
+        }
+        return status;
+}
@@ -113,6 +113,10 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "A5.h"
 
 
 /* Masks for the shift registers */
@@ -158,7 +162,7 @@ typedef word bit;
 
 /* Calculate the parity of a 32-bit word, i.e. the sum of its bits modulo 2
 */
-bit parity(word x) {
+static bit parity(word x) {
         x ^= x>>16;
         x ^= x>>8;
         x ^= x>>4;
@@ -172,9 +176,9 @@ bit parity(word x) {
  * is loaded in, one particular bit of each register is forced to '1';
  * that bit is passed in as the last argument. */
 #ifndef A5_2
-word clockone(word reg, word mask, word taps) {
+static word clockone(word reg, word mask, word taps) {
 #else /* A5_2 */
-word clockone(word reg, word mask, word taps, word loaded_bit) {
+static word clockone(word reg, word mask, word taps, word loaded_bit) {
 #endif /* A5_2 */
         word t = reg & taps;
         reg = (reg << 1) & mask;
@@ -186,17 +190,69 @@ word clockone(word reg, word mask, word taps, word loaded_bit) {
 }
 
 
-/* The three shift registers.  They're in global variables to make the code
- * easier to understand.
- * A better implementation would not use global variables. */
-word R1, R2, R3;
+/* The state of one session.  The reference implementation kept the
+ * shift registers in global variables to make the code easier to
+ * understand; here they live in a context, so that any number of
+ * sessions can be set up side by side, from different threads if
+ * need be.  The A5/2 delayed output bit is part of that state too.
+ *
+ * There are two ways to do the key setup.  The clocked one is the
+ * reference implementation's: clock the key, then the frame number, into
+ * the registers one bit at a time.  It keeps the registers as they are
+ * after the key is loaded, for the last key seen, so that several frames
+ * under one key only load the frame number.
+ *
+ * The linear one, which a5_new() picks, relies on key and frame loading
+ * clocking every register whatever its contents, so that loading is
+ * linear: the registers after it are the XOR of what each key bit
+ * and each frame bit would leave there on its own.  keyR1[i]..keyR4[i]
+ * hold what key bit i leaves after all 86 loading clocks.  The key's
+ * share is kept for the last key seen, and the frame number's share for
+ * the last frame number seen, so that several frames under one key
+ * skip the key loading and many keys at one frame number (table and
+ * codebook generation) skip the frame loading.  The hit and miss
+ * counts tell how often the last key was reused, on either path;
+ * a5_cachestats() reports them. */
+struct a5_ctx {
+        int linear;
+
+        word R1, R2, R3;
 #ifdef A5_2
-word R4;
+        word R4;
+        bit delaybit;
 #endif /* A5_2 */
 
+        word keyR1[64], keyR2[64], keyR3[64];
+#ifdef A5_2
+        word keyR4[64];
+#endif /* A5_2 */
+
+        byte cachedkey[8];
+        int cachedvalid;
+        word cachedR1, cachedR2, cachedR3;
+#ifdef A5_2
+        word cachedR4;
+#endif /* A5_2 */
+        unsigned long cachehits, cachemisses;
+
+        word cachedframe;
+        int framevalid;
+        word frameR1, frameR2, frameR3;
+#ifdef A5_2
+        word frameR4;
+#endif /* A5_2 */
+
+        byte loadedkey[8];
+        int loadedvalid;
+        word loadedR1, loadedR2, loadedR3;
+#ifdef A5_2
+        word loadedR4;
+#endif /* A5_2 */
+};
+
 
 /* Return 1 iff at least two of the parameter words are non-zero. */
-bit majority(word w1, word w2, word w3) {
+static bit majority(word w1, word w2, word w3) {
         int sum = (w1 != 0) + (w2 != 0) + (w3 != 0);
         if (sum >= 2)
                 return 1;
@@ -215,24 +271,25 @@ bit majority(word w1, word w2, word w3) {
  * This is only used for key setup.  If loaded == 1, then this is the last
  * bit of the frame number, and if we're doing A5/2, we have to set a
  * particular bit in each of the four registers. */
-void clock(int allP, int loaded) {
+static void clock(a5_ctx *c, int allP, int loaded) {
 #ifndef A5_2
-        bit maj = majority(R1&R1MID, R2&R2MID, R3&R3MID);
-        if (allP || (((R1&R1MID)!=0) == maj))
-                R1 = clockone(R1, R1MASK, R1TAPS);
-        if (allP || (((R2&R2MID)!=0) == maj))
-                R2 = clockone(R2, R2MASK, R2TAPS);
-        if (allP || (((R3&R3MID)!=0) == maj))
-                R3 = clockone(R3, R3MASK, R3TAPS);
+        (void)loaded; /* nothing is forced in A5/1 */
+        bit maj = majority(c->R1&R1MID, c->R2&R2MID, c->R3&R3MID);
+        if (allP || (((c->R1&R1MID)!=0) == maj))
+                c->R1 = clockone(c->R1, R1MASK, R1TAPS);
+        if (allP || (((c->R2&R2MID)!=0) == maj))
+                c->R2 = clockone(c->R2, R2MASK, R2TAPS);
+        if (allP || (((c->R3&R3MID)!=0) == maj))
+                c->R3 = clockone(c->R3, R3MASK, R3TAPS);
 #else /* A5_2 */
-        bit maj = majority(R4&R4TAP1, R4&R4TAP2, R4&R4TAP3);
-        if (allP || (((R4&R4TAP1)!=0) == maj))
-                R1 = clockone(R1, R1MASK, R1TAPS, loaded<<15);
-        if (allP || (((R4&R4TAP2)!=0) == maj))
-                R2 = clockone(R2, R2MASK, R2TAPS, loaded<<16);
-        if (allP || (((R4&R4TAP3)!=0) == maj))
-                R3 = clockone(R3, R3MASK, R3TAPS, loaded<<18);
-        R4 = clockone(R4, R4MASK, R4TAPS, loaded<<10);
+        bit maj = majority(c->R4&R4TAP1, c->R4&R4TAP2, c->R4&R4TAP3);
+        if (allP || (((c->R4&R4TAP1)!=0) == maj))
+                c->R1 = clockone(c->R1, R1MASK, R1TAPS, loaded<<15);
+        if (allP || (((c->R4&R4TAP2)!=0) == maj))
+                c->R2 = clockone(c->R2, R2MASK, R2TAPS, loaded<<16);
+        if (allP || (((c->R4&R4TAP3)!=0) == maj))
+                c->R3 = clockone(c->R3, R3MASK, R3TAPS, loaded<<18);
+        c->R4 = clockone(c->R4, R4MASK, R4TAPS, loaded<<10);
 #endif /* A5_2 */
 }
 
@@ -244,50 +301,136 @@ void clock(int allP, int loaded) {
  * of three particular bits of the register (one of them complemented)
  * to make it non-linear.  Also, for A5/2, delay the output by one
  * clock cycle for some reason. */
-bit getbit() {
-        bit topbits = (((R1 >> 18) ^ (R2 >> 21) ^ (R3 >> 22)) & 0x01);
+static bit getbit(a5_ctx *c) {
+        bit topbits = (((c->R1 >> 18) ^ (c->R2 >> 21) ^ (c->R3 >> 22)) & 0x01);
 #ifndef A5_2
         return topbits;
 #else /* A5_2 */
-        static bit delaybit = 0;
-        bit nowbit = delaybit;
-        delaybit = (
+        bit nowbit = c->delaybit;
+        c->delaybit = (
             topbits
-            ^ majority(R1&0x8000, (~R1)&0x4000, R1&0x1000)
-            ^ majority((~R2)&0x10000, R2&0x2000, R2&0x200)
-            ^ majority(R3&0x40000, R3&0x10000, (~R3)&0x2000)
+            ^ majority(c->R1&0x8000, (~c->R1)&0x4000, c->R1&0x1000)
+            ^ majority((~c->R2)&0x10000, c->R2&0x2000, c->R2&0x200)
+            ^ majority(c->R3&0x40000, c->R3&0x10000, (~c->R3)&0x2000)
             );
         return nowbit;
 #endif /* A5_2 */
 }
 
 
-/* Do the A5 key setup.  This routine accepts a 64-bit key and
- * a 22-bit frame number. */
-void keysetup(byte key[8], word frame) {
+/* Clock all the registers n times, ignoring the usual clock control
+ * rule, and XOR the low n bits of bits into them, LSB first.  This is
+ * how the key setup loads both the key and the frame number. */
+static void loadbits(a5_ctx *c, word bits, int n) {
+        int i;
+        bit b;
+
+        for (i=0; i<n; i++) {
+                clock(c, 1, 0); /* always clock */
+                b = (bits >> i) & 1;
+                c->R1 ^= b; c->R2 ^= b; c->R3 ^= b;
+#ifdef A5_2
+                c->R4 ^= b;
+#endif /* A5_2 */
+        }
+}
+
+
+/* Work out keyR1[i]..keyR4[i]: load a key whose only set bit is the
+ * i-th one (LSB of first byte of key array first), then 22 zero frame
+ * bits. */
+static void setupcolumns(a5_ctx *c) {
+        int i;
+
+        for (i=0; i<64; i++) {
+                c->R1 = c->R2 = c->R3 = 0;
+#ifdef A5_2
+                c->R4 = 0;
+#endif /* A5_2 */
+                loadbits(c, 0, i);
+                loadbits(c, 1, 1);
+                loadbits(c, 0, 63-i);
+                loadbits(c, 0, 22);
+                c->keyR1[i] = c->R1; c->keyR2[i] = c->R2; c->keyR3[i] = c->R3;
+#ifdef A5_2
+                c->keyR4[i] = c->R4;
+#endif /* A5_2 */
+        }
+}
+
+
+/* Allocate a context for one session.  This is where the key loading
+ * columns are worked out.  This is the only call that allocates,
+ * apart from the C library's own buffers for the keystream files.
+ * Returns NULL if there is not enough memory. */
+a5_ctx *a5_new(void) {
+        a5_ctx *c = calloc(1, sizeof(a5_ctx));
+
+        if (c != NULL) {
+                setupcolumns(c);
+                c->linear = 1;
+        }
+        return c;
+}
+
+
+/* Free a context allocated by a5_new(). */
+void a5_free(a5_ctx *c) {
+        free(c);
+}
+
+
+/* Choose the linear key setup (on != 0), or the clocked reference one.
+ * Both give the same keystream. */
+void a5_setlinear(a5_ctx *c, int on) {
+        c->linear = on != 0;
+}
+
+
+/* Load the key and the frame number the way the reference
+ * implementation does, one bit per clock.  The registers as they are
+ * after the key is loaded are reused if the key is the same one as
+ * last time. */
+static void clockedload(a5_ctx *c, const byte key[8], word frame) {
         int i;
         bit keybit, framebit;
 
 
-        /* Zero out the shift registers. */
-        R1 = R2 = R3 = 0;
+        if (c->loadedvalid && memcmp(key, c->loadedkey, 8) == 0) {
+                c->R1 = c->loadedR1; c->R2 = c->loadedR2; c->R3 = c->loadedR3;
 #ifdef A5_2
-        R4 = 0;
+                c->R4 = c->loadedR4;
+#endif /* A5_2 */
+                c->cachehits++;
+        } else {
+                /* Zero out the shift registers. */
+                c->R1 = c->R2 = c->R3 = 0;
+#ifdef A5_2
+                c->R4 = 0;
 #endif /* A5_2 */
 
 
-        /* Load the key into the shift registers,
-         * LSB of first byte of key array first,
-         * clocking each register once for every
-         * key bit loaded.  (The usual clock
-         * control rule is temporarily disabled.) */
-        for (i=0; i<64; i++) {
-                clock(1,0); /* always clock */
-                keybit = (key[i/8] >> (i&7)) & 1; /* The i-th bit of the key */
-                R1 ^= keybit; R2 ^= keybit; R3 ^= keybit;
+                /* Load the key into the shift registers,
+                 * LSB of first byte of key array first,
+                 * clocking each register once for every
+                 * key bit loaded.  (The usual clock
+                 * control rule is temporarily disabled.) */
+                for (i=0; i<64; i++) {
+                        clock(c, 1, 0); /* always clock */
+                        keybit = (key[i/8] >> (i&7)) & 1; /* The i-th bit of the key */
+                        c->R1 ^= keybit; c->R2 ^= keybit; c->R3 ^= keybit;
 #ifdef A5_2
-                R4 ^= keybit;
+                        c->R4 ^= keybit;
 #endif /* A5_2 */
+                }
+
+                memcpy(c->loadedkey, key, 8);
+                c->loadedR1 = c->R1; c->loadedR2 = c->R2; c->loadedR3 = c->R3;
+#ifdef A5_2
+                c->loadedR4 = c->R4;
+#endif /* A5_2 */
+                c->loadedvalid = 1;
+                c->cachemisses++;
         }
 
 
@@ -296,15 +439,93 @@ void keysetup(byte key[8], word frame) {
          * (The usual clock control rule is still disabled.)
          * For A5/2, signal when the last bit is being clocked in. */
         for (i=0; i<22; i++) {
-                clock(1,i==21); /* always clock */
+                clock(c, 1, i==21); /* always clock */
                 framebit = (frame >> i) & 1; /* The i-th bit of the frame # */
-                R1 ^= framebit; R2 ^= framebit; R3 ^= framebit;
+                c->R1 ^= framebit; c->R2 ^= framebit; c->R3 ^= framebit;
+#ifdef A5_2
+                c->R4 ^= framebit;
+#endif /* A5_2 */
+        }
+}
+
+
+/* Load the key and the frame number as the XOR of their shares. */
+static void linearload(a5_ctx *c, const byte key[8], word frame) {
+        int i;
+
+
+        /* The key's share of the loaded registers: the columns
+         * of the key bits that are set.  Reused if the key is
+         * the same one as last time. */
+        if (c->cachedvalid && memcmp(key, c->cachedkey, 8) == 0) {
+                c->cachehits++;
+        } else {
+                c->cachedR1 = c->cachedR2 = c->cachedR3 = 0;
+#ifdef A5_2
+                c->cachedR4 = 0;
+#endif /* A5_2 */
+                for (i=0; i<64; i++) {
+                        if (((key[i/8] >> (i&7)) & 1) == 0)
+                                continue;
+                        c->cachedR1 ^= c->keyR1[i];
+                        c->cachedR2 ^= c->keyR2[i];
+                        c->cachedR3 ^= c->keyR3[i];
+#ifdef A5_2
+                        c->cachedR4 ^= c->keyR4[i];
+#endif /* A5_2 */
+                }
+                memcpy(c->cachedkey, key, 8);
+                c->cachedvalid = 1;
+                c->cachemisses++;
+        }
+
+
+        /* The frame number's share: load the frame number, LSB
+         * first, into empty registers.  Reused if the frame number
+         * is the same one as last time. */
+        if (!c->framevalid || frame != c->cachedframe) {
+                c->R1 = c->R2 = c->R3 = 0;
 #ifdef A5_2
-                R4 ^= framebit;
+                c->R4 = 0;
 #endif /* A5_2 */
+                loadbits(c, frame, 22);
+                c->frameR1 = c->R1; c->frameR2 = c->R2; c->frameR3 = c->R3;
+#ifdef A5_2
+                c->frameR4 = c->R4;
+#endif /* A5_2 */
+                c->cachedframe = frame;
+                c->framevalid = 1;
         }
 
 
+        c->R1 = c->cachedR1 ^ c->frameR1;
+        c->R2 = c->cachedR2 ^ c->frameR2;
+        c->R3 = c->cachedR3 ^ c->frameR3;
+#ifdef A5_2
+        c->R4 = c->cachedR4 ^ c->frameR4;
+
+        /* For A5/2, one particular bit of each register is forced
+         * to 1 when the last bit of the frame number is loaded in.
+         * Since loading is linear up to that point and none of these
+         * bits is bit 0, where the last frame bit goes, they can be
+         * set here, after the two shares are combined. */
+        c->R1 |= 1<<15; c->R2 |= 1<<16; c->R3 |= 1<<18; c->R4 |= 1<<10;
+#endif /* A5_2 */
+}
+
+
+/* Do the A5 key setup.  This routine accepts a 64-bit key and
+ * a 22-bit frame number. */
+void a5_keysetup(a5_ctx *c, const byte key[8], word frame) {
+        int i;
+
+
+        if (c->linear)
+                linearload(c, key, frame);
+        else
+                clockedload(c, key, frame);
+
+
         /* Run the shift registers for 100 clocks
          * to mix the keying material and frame number
          * together with output generation disabled,
@@ -312,24 +533,45 @@ void keysetup(byte key[8], word frame) {
          * We re-enable the majority-based clock control
          * rule from now on. */
         for (i=0; i<100; i++) {
-                clock(0,0);
+                clock(c, 0, 0);
         }
         /* For A5/2, we have to load the delayed output bit.  This does _not_
          * change the state of the registers.  For A5/1, this is a no-op. */
-        getbit();
+        getbit(c);
 
 
         /* Now the key is properly set up. */
 }
 
 
+/* Report how many key setups so far reused the work done for the last
+ * key (hits) and how many had to load the key (misses). */
+void a5_cachestats(a5_ctx *c, unsigned long *hits, unsigned long *misses) {
+        *hits = c->cachehits;
+        *misses = c->cachemisses;
+}
+
+
+/* Generate 114 bits of keystream and XOR them into a burst,
+ * MSB first.  The 6 bits past the end of the burst in the last
+ * byte are left alone. */
+static void xorburst(a5_ctx *c, byte burst[]) {
+        int i;
+
+        for (i=0; i<114; i++) {
+                clock(c, 0, 0);
+                burst[i/8] ^= getbit(c) << (7-(i&7));
+        }
+}
+
+
 /* Generate output.  We generate 228 bits of
  * keystream output.  The first 114 bits is for
  * the A->B frame; the next 114 bits is for the
  * B->A frame.  You allocate a 15-byte buffer
  * for each direction, and this function fills
  * it in. */
-void run(byte AtoBkeystream[], byte BtoAkeystream[]) {
+void a5_run(a5_ctx *c, byte AtoBkeystream[], byte BtoAkeystream[]) {
         int i;
 
 
@@ -339,93 +581,192 @@ void run(byte AtoBkeystream[], byte BtoAkeystream[]) {
 
 
         /* Generate 114 bits of keystream for the
-         * A->B direction.  Store it, MSB first. */
+         * A->B direction, then for the B->A direction. */
+        xorburst(c, AtoBkeystream);
+        xorburst(c, BtoAkeystream);
+}
+
+
+/* Encrypt (or decrypt) the two bursts of the current frame in place.
+ * Same as XORing in the output of a5_run(), but without going through
+ * separate keystream buffers.  The bursts are packed in 15-byte
+ * buffers, MSB first, like the output of a5_run(). */
+void a5_encrypt(a5_ctx *c, byte AtoB[], byte BtoA[]) {
+        xorburst(c, AtoB);
+        xorburst(c, BtoA);
+}
+
+
+/* Same as a5_encrypt(), for bursts unpacked one bit per byte:
+ * 114 bytes per direction, each 0 or 1. */
+void a5_encryptbits(a5_ctx *c, byte AtoB[], byte BtoA[]) {
+        int i;
+
         for (i=0; i<114; i++) {
-                clock(0,0);
-                AtoBkeystream[i/8] |= getbit() << (7-(i&7));
+                clock(c, 0, 0);
+                AtoB[i] ^= getbit(c);
         }
+        for (i=0; i<114; i++) {
+                clock(c, 0, 0);
+                BtoA[i] ^= getbit(c);
+        }
+}
 
 
-        /* Generate 114 bits of keystream for the
-         * B->A direction.  Store it, MSB first. */
+/* Same as a5_encrypt(), for soft bits from a demodulator: 114 signed
+ * values per direction.  A positive value is a 0 bit and a negative
+ * value a 1 bit, with the magnitude as the confidence; 0 is an
+ * erasure.  A keystream bit of 1 negates the value, a 0 leaves it as
+ * it is, so magnitudes and erasures are kept.  -128, which has no
+ * positive counterpart, saturates to 127. */
+void a5_encryptsoft(a5_ctx *c, signed char AtoB[], signed char BtoA[]) {
+        int i;
+
+        for (i=0; i<114; i++) {
+                clock(c, 0, 0);
+                if (getbit(c))
+                        AtoB[i] = AtoB[i] == -128 ? 127 : -AtoB[i];
+        }
         for (i=0; i<114; i++) {
-                clock(0,0);
-                BtoAkeystream[i/8] |= getbit() << (7-(i&7));
+                clock(c, 0, 0);
+                if (getbit(c))
+                        BtoA[i] = BtoA[i] == -128 ? 127 : -BtoA[i];
         }
 }
 
 
-/* Test the code by comparing it against
- * a known-good test vector. */
-void test() {
-#ifndef A5_2
-        byte key[8] = {0x12, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF};
-        word frame = 0x134;
-        byte goodAtoB[15] = { 0x53, 0x4E, 0xAA, 0x58, 0x2F, 0xE8, 0x15,
-                              0x1A, 0xB6, 0xE1, 0x85, 0x5A, 0x72, 0x8C, 0x00 };
-        byte goodBtoA[15] = { 0x24, 0xFD, 0x35, 0xA3, 0x5D, 0x5F, 0xB6,
-                              0x52, 0x6D, 0x32, 0xF9, 0x06, 0xDF, 0x1A, 0xC0 };
-#else /* A5_2 */
-        byte key[8] = {0x00, 0xfc, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
-        word frame = 0x21;
-        byte goodAtoB[15] = { 0xf4, 0x51, 0x2c, 0xac, 0x13, 0x59, 0x37,
-                              0x64, 0x46, 0x0b, 0x72, 0x2d, 0xad, 0xd5, 0x00 };
-        byte goodBtoA[15] = { 0x48, 0x00, 0xd4, 0x32, 0x8e, 0x16, 0xa1,
-                              0x4d, 0xcd, 0x7b, 0x97, 0x22, 0x26, 0x51, 0x00 };
-#endif /* A5_2 */
-        byte AtoB[15], BtoA[15];
-        int i, failed=0;
+/* Generate the keystream of a batch of n frames into caller-provided
+ * buffers.  Frame j is frame number frames[j] under key keys[j]; its
+ * A->B and B->A keystream go to AtoB[j] and BtoA[j], as from a5_run().
+ * Nothing is allocated. */
+void a5_runbatch(a5_ctx *c, const byte keys[][8], const word frames[],
+                 int n, byte AtoB[][15], byte BtoA[][15]) {
+        int j;
 
+        for (j=0; j<n; j++) {
+                a5_keysetup(c, keys[j], frames[j]);
+                a5_run(c, AtoB[j], BtoA[j]);
+        }
+}
 
-        keysetup(key, frame);
-        run(AtoB, BtoA);
 
+/* Encrypt (or decrypt: it is the same operation) a batch of n frames.
+ * Frame j is frame number frames[j] under key keys[j]; its two 114-bit
+ * bursts are in AtoB[j] and BtoA[j], MSB first, and are overwritten
+ * with the result.  Nothing is allocated.  Submitting the frames of
+ * one session next to each other lets a5_keysetup() skip the key
+ * loading for all but the first of them. */
+void a5_encryptbatch(a5_ctx *c, const byte keys[][8], const word frames[],
+                     int n, byte AtoB[][15], byte BtoA[][15]) {
+        int j;
 
-        /* Compare against the test vector. */
-        for (i=0; i<15; i++)
-                if (AtoB[i] != goodAtoB[i])
-                        failed = 1;
-        for (i=0; i<15; i++)
-                if (BtoA[i] != goodBtoA[i])
-                        failed = 1;
+        for (j=0; j<n; j++) {
+                a5_keysetup(c, keys[j], frames[j]);
+                a5_encrypt(c, AtoB[j], BtoA[j]);
+        }
+}
 
 
-        /* Print some debugging output. */
-        printf("A5 Original\n");
-        printf("key: 0x");
-        for (i=0; i<8; i++)
-                printf("%02X", key[i]);
-        printf("\n");
-        printf("frame number: 0x%06X\n", (unsigned int)frame);
-        printf("known good output:\n");
-        printf(" A->B: 0x");
-        for (i=0; i<15; i++)
-                printf("%02X", goodAtoB[i]);
-        printf("  B->A: 0x");
-        for (i=0; i<15; i++)
-                printf("%02X", goodBtoA[i]);
-        printf("\n");
-        printf("observed output:\n");
-        printf(" A->B: 0x");
-        for (i=0; i<15; i++)
-                printf("%02X", AtoB[i]);
-        printf("  B->A: 0x");
-        for (i=0; i<15; i++)
-                printf("%02X", BtoA[i]);
-        printf("\n");
-
-
-        if (!failed) {
-                printf("Self-check succeeded: everything looks ok.\n");
-                exit(0);
-        } else {
-                /* Problems!  The test vectors didn't compare*/
-                printf("\nI don't know why this broke; contact the authors.\n");
+/* Keystream files start with a 20-byte header: the algorithm ("A5/1"
+ * or "A5/2"), the 8-byte key, then the first and the last frame number
+ * in the file, 4 bytes each, MSB first.  The key is stored as it is;
+ * the keystream after it gives away the same calls anyway. */
+#ifndef A5_2
+#define KSMAGIC "A5/1"
+#else /* A5_2 */
+#define KSMAGIC "A5/2"
+#endif /* A5_2 */
+#define KSHEADER 20
+
+
+/* Store the keystream of frames first..last under one key in a file,
+ * so that decrypting the same call again needs no key setup at all.
+ * After the header, each frame takes 30 bytes: the 15-byte A->B buffer
+ * followed by the 15-byte B->A buffer, exactly as filled in by a5_run().
+ * The record for frame number f starts at byte 20+(f-first)*30.
+ * The file is written under a new, unique name next to filename and
+ * only renamed to filename once it is complete, so a failed write
+ * neither leaves a truncated file behind nor touches an existing file.
+ * Like any file made by mkstemp(), it is readable by its owner only.
+ * Returns 0 on success, -1 if the range is not a valid range of frame
+ * numbers or the file could not be written. */
+int a5_savekeystream(a5_ctx *c, const byte key[8], word first, word last,
+                     const char *filename) {
+        byte header[KSHEADER], AtoB[15], BtoA[15];
+        char tmpname[FILENAME_MAX];
+        word frame;
+        int i, fd, failed = 0;
+        FILE *f;
+
+        if (first > last || last > 0x3FFFFF)
+                return -1;
+        if (strlen(filename) + 8 > sizeof(tmpname))
+                return -1;
+        strcpy(tmpname, filename);
+        strcat(tmpname, ".XXXXXX");
+        if ((fd = mkstemp(tmpname)) < 0)
+                return -1;
+        if ((f = fdopen(fd, "wb")) == NULL) {
+                close(fd);
+                remove(tmpname);
+                return -1;
         }
+
+        memcpy(header, KSMAGIC, 4);
+        memcpy(header+4, key, 8);
+        for (i=0; i<4; i++) {
+                header[12+i] = (first >> (24-8*i)) & 0xFF;
+                header[16+i] = (last >> (24-8*i)) & 0xFF;
+        }
+        if (fwrite(header, 1, KSHEADER, f) != KSHEADER)
+                failed = 1;
+        for (frame=first; !failed && frame<=last; frame++) {
+                a5_keysetup(c, key, frame);
+                a5_run(c, AtoB, BtoA);
+                if (fwrite(AtoB, 1, 15, f) != 15 || fwrite(BtoA, 1, 15, f) != 15)
+                        failed = 1;
+        }
+        if (fclose(f) != 0)
+                failed = 1;
+        if (!failed && rename(tmpname, filename) != 0)
+                failed = 1;
+        if (failed) {
+                remove(tmpname);
+                return -1;
+        }
+        return 0;
 }
 
 
-int main(void) {
-        test();
-        return 0;
+/* Fetch the keystream of one frame under key from a file written by
+ * a5_savekeystream().  This reads the header and seeks once; nothing
+ * is recomputed.
+ * Returns 0 on success, -1 if the file cannot be read, is not a
+ * keystream file for this algorithm and key, or the frame is not in
+ * it. */
+int a5_loadkeystream(const char *filename, const byte key[8], word frame,
+                     byte AtoB[], byte BtoA[]) {
+        byte header[KSHEADER];
+        word first = 0, last = 0;
+        int i, failed = 0;
+        FILE *f;
+
+        if ((f = fopen(filename, "rb")) == NULL)
+                return -1;
+        if (fread(header, 1, KSHEADER, f) != KSHEADER
+            || memcmp(header, KSMAGIC, 4) != 0
+            || memcmp(header+4, key, 8) != 0)
+                failed = 1;
+        for (i=0; i<4; i++) {
+                first = (first << 8) | header[12+i];
+                last = (last << 8) | header[16+i];
+        }
+        if (!failed && (frame < first || frame > last))
+                failed = 1;
+        if (!failed && fseek(f, KSHEADER + (long)(frame-first)*30, SEEK_SET) != 0)
+                failed = 1;
+        if (!failed && (fread(AtoB, 1, 15, f) != 15 || fread(BtoA, 1, 15, f) != 15))
+                failed = 1;
+        fclose(f);
+        return failed ? -1 : 0;
 }